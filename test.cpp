@@ -5,6 +5,10 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <future>
+#include <cassert>
+#include <array>
+#include <stdexcept>
 
 using ULong = unsigned long long;
 
@@ -47,6 +51,142 @@ int main() {
         ULong sum1 = res1.get().cast_<ULong>();
         std::cout << sum1 << std::endl;
     }
+
+    std::cout << "测试完成队列" << std::endl;
+    {
+        ThreadPool pool;
+        pool.start(4);
+        CompletionQueue cq;
+
+        // 区间长度不同，任务完成的先后顺序和提交顺序不一样
+        pool.submitTask(std::make_shared<MyTask>(1,400000000), cq);
+        pool.submitTask(std::make_shared<MyTask>(1,100), cq);
+        pool.submitTask(std::make_shared<MyTask>(1,100000000), cq);
+        pool.submitTask(std::make_shared<MyTask>(1,1000000), cq);
+
+        // 按完成顺序取结果，先一个一个取，再一批取完剩下的
+        CompletionQueue::Completion first = cq.pop();
+        ULong firstSum = first.value.cast_<ULong>();
+        std::cout << "first done: " << firstSum << std::endl;
+        // 最短的任务最先完成
+        assert(firstSum == 4950);
+
+        std::vector<CompletionQueue::Completion> rest;
+        while(rest.size() < 3) {
+            cq.popBatchFor(rest, 3 - rest.size(), std::chrono::milliseconds(100));
+        }
+        for(auto& c : rest) {
+            std::cout << "done: " << c.value.cast_<ULong>() << std::endl;
+        }
+        // 最长的任务最后完成
+        assert(rest.back().value.cast_<ULong>() == 79999999800000000ULL);
+
+        CompletionQueue::Completion none;
+        std::cout << "tryPop on empty queue: " << cq.tryPop(none) << std::endl;
+        assert(!cq.tryPop(none));
+        // 空队列上等待超时返回 false
+        bool got = cq.popFor(none, std::chrono::milliseconds(50));
+        std::cout << "popFor on empty queue: " << got << std::endl;
+        assert(!got);
+
+        // 不阻塞地批量取，没完成之前取到 0 个
+        pool.submitTask(std::make_shared<MyTask>(1,100), cq);
+        std::vector<CompletionQueue::Completion> batch;
+        while(cq.tryPopBatch(batch, 8) == 0) {
+            std::this_thread::yield();
+        }
+        std::cout << "tryPopBatch: " << batch.front().value.cast_<ULong>() << std::endl;
+        assert(batch.size() == 1 && batch.front().value.cast_<ULong>() == 4950);
+    }
+
+    std::cout << "测试提交可调用对象" << std::endl;
+    {
+        ThreadPool pool;
+        pool.start(4);
+
+        // 普通 lambda + 参数
+        std::future<ULong> res1 = pool.submit([](int begin, int end) {
+            ULong sum = 0;
+            for(int i = begin; i < end; ++i) {
+                sum += i;
+            }
+            return sum;
+        }, 1, 100000000);
+
+        // 只能移动的捕获
+        auto data = std::make_unique<int>(42);
+        std::future<int> res2 = pool.submit([data = std::move(data)]() { return *data; });
+
+        // 没有返回值
+        std::future<void> res3 = pool.submit([]() {
+            std::cout << "tid:"<< std::this_thread::get_id() << " void task" << std::endl;
+        });
+
+        // 任务抛出的异常在 future.get() 时重新抛出
+        std::future<int> res4 = pool.submit([]() -> int {
+            throw std::runtime_error("task failed");
+        });
+
+        // 捕获超过内联缓冲区，放到堆上
+        std::array<ULong, 16> big;
+        big.fill(1);
+        std::future<ULong> res5 = pool.submit([big]() {
+            ULong sum = 0;
+            for(ULong v : big) {
+                sum += v;
+            }
+            return sum;
+        });
+
+        // 不需要返回值，没有 promise
+        std::atomic_int counter(0);
+        for(int i = 0; i < 10; ++i) {
+            pool.execute([&counter](int n) { counter += n; }, 1);
+        }
+
+        std::cout << res1.get() << std::endl;
+        std::cout << res2.get() << std::endl;
+        res3.get();
+        try {
+            res4.get();
+            assert(false);
+        } catch(const std::runtime_error& e) {
+            std::cout << "exception: " << e.what() << std::endl;
+        }
+        ULong bigSum = res5.get();
+        std::cout << "big capture: " << bigSum << std::endl;
+        assert(bigSum == 16);
+
+        while(counter < 10) {
+            std::this_thread::yield();
+        }
+        std::cout << "execute: " << counter << std::endl;
+    }
+
+    std::cout << "测试 Function 堆上存储和移动" << std::endl;
+    {
+        // 超过 BufferSize 的捕获
+        std::array<char, 2 * ThreadPool::TaskFunc::BufferSize> big;
+        big.fill('a');
+        Function<int()> f1([big]() { return static_cast<int>(big.size()); });
+        Function<int()> f2(std::move(f1));
+        assert(!f1);
+        std::cout << "heap: " << f2() << std::endl;
+        assert(f2() == 2 * ThreadPool::TaskFunc::BufferSize);
+
+        // 移动可能抛异常的类型也放到堆上
+        struct ThrowingMove {
+            ThrowingMove() = default;
+            ThrowingMove(ThrowingMove&&) noexcept(false) {}
+            int operator()() { return 7; }
+        };
+        Function<int()> f3{ThrowingMove()};
+        Function<int()> f4;
+        f4 = std::move(f3);
+        assert(!f3);
+        std::cout << "throwing move: " << f4() << std::endl;
+        assert(f4() == 7);
+    }
     std::cout << "main() over" << std::endl;
     // 防止没打印完就结束了
     std::this_thread::sleep_for(std::chrono::seconds(5));
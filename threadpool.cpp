@@ -70,14 +70,15 @@ void ThreadPool::start(int initThreadSize) {
     // 创建线程对象, 集中创建再启动，更加公平
     for (int i = 0; i < initThreadSize_; ++i) {
         // 创建线程对象的时候把线程函数给到 thread 线程对象
-        auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc,this,std::placeholders::_1));
+        auto ptr = std::make_unique<Thread>([this](int threadid) { threadFunc(threadid); });
         int threadId = ptr->getId();
         threads_.emplace(threadId, std::move(ptr));
     }
 
     // 启动所有线程
-    for (int i = 0; i < initThreadSize_; ++i) {
-        threads_[i]->start();   // 去执行一个线程函数
+    // 线程 id 是全局递增的，不一定从 0 开始，遍历容器启动
+    for (auto& item : threads_) {
+        item.second->start();   // 去执行一个线程函数
         idleThreadSize_++;      // 记录初始空闲线程数量
     }
 }
@@ -87,6 +88,31 @@ Result ThreadPool::submitTask(std::shared_ptr<Task> sp) {
     // 获取锁
     std::unique_lock<std::mutex> lock(taskQueMtx_);
 
+    if(!enqueueTask(lock, [sp]() { sp->exec(); })) {
+        // return task->getResult(); Task Result 考虑清楚生命周期
+        // 线程执行完 task, task 对象就被析构掉了，result 依赖task 所以也不行，用下面的
+        // 提交失败还要设置返回值无效
+        return Result(sp, false);
+    }
+
+    // 返回任务的 Result 对象
+    // return task->getResult();
+    // 返回之前还持有锁，worker 线程拿到任务之前 Result 已经绑定到 task 上了
+    return Result(sp);
+
+}
+
+/// 给线程池提交任务 任务执行完的返回值压入完成队列 cq
+bool ThreadPool::submitTask(std::shared_ptr<Task> sp, CompletionQueue& cq) {
+    // 先绑定完成队列再入队，worker 线程取到任务时一定能看到 cq
+    sp->setCompletionQueue(&cq);
+
+    std::unique_lock<std::mutex> lock(taskQueMtx_);
+    return enqueueTask(lock, [sp]() { sp->exec(); });
+}
+
+/// 把任务放到任务队列中，调用者持有 taskQueMtx_
+bool ThreadPool::enqueueTask(std::unique_lock<std::mutex>& lock, TaskFunc&& task) {
     // 线程的通信 等待任务队列有空余
     //    while(taskQue_.size() == taskQueMaxSizeThreshold_) {
     //        notFull_.wait(lock);
@@ -96,14 +122,11 @@ Result ThreadPool::submitTask(std::shared_ptr<Task> sp) {
                       [&]()->bool {return taskQue_.size() < taskQueMaxSizeThreshold_;})) {
         // 表示 notFull_ 等待 1s, 条件依然没满足
         std::cerr << "task queue is full, submit task fail." << std::endl;
-        // return task->getResult(); Task Result 考虑清楚生命周期
-        // 线程执行完 task, task 对象就被析构掉了，result 依赖task 所以也不行，用下面的
-        // 提交失败还要设置返回值无效
-        return Result(sp, false);
+        return false;
     }
 
     // 如果有空余，把任务放到任务队列中
-    taskQue_.emplace(sp);
+    taskQue_.emplace(std::move(task));
     ++taskSize_;
 
     // 因为新放了任务，任务队列肯定不空了，在 notEmpty_ 上进行通知, 赶快分配线程执行任务 （消费）
@@ -116,7 +139,7 @@ Result ThreadPool::submitTask(std::shared_ptr<Task> sp) {
         &&  curThreadSize_ < threadSizeThreshold_) {
         std::cout << "create new thread..." << std::endl;
         // 创建新线程对象
-        auto ptr = std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc,this,std::placeholders::_1));
+        auto ptr = std::make_unique<Thread>([this](int threadid) { threadFunc(threadid); });
         int threadId = ptr->getId();
         threads_.emplace(threadId, std::move(ptr));
 
@@ -128,18 +151,14 @@ Result ThreadPool::submitTask(std::shared_ptr<Task> sp) {
         idleThreadSize_++;
     }
 
-    // 返回任务的 Result 对象
-    // return task->getResult();
-
-    return Result(sp);
-
+    return true;
 }
 
 /// 定义线程函数 线程池的所有线程从任务队列里 消费任务
 void ThreadPool::threadFunc(int threadid) { // 线程函数返回，相应的线程也就结束了
     auto lastTime = std::chrono::high_resolution_clock().now();
     while(isPoolRunning_){
-        std::shared_ptr<Task> task;
+        TaskFunc task;
         {
             // 先取锁
             std::unique_lock<std::mutex> lock(taskQueMtx_);
@@ -189,7 +208,7 @@ void ThreadPool::threadFunc(int threadid) { // 线程函数返回，相应的线
             idleThreadSize_--;
 
             // 从任务队列中取一个任务出来
-            task = taskQue_.front();
+            task = std::move(taskQue_.front());
             taskQue_.pop();
             --taskSize_;
 
@@ -203,11 +222,11 @@ void ThreadPool::threadFunc(int threadid) { // 线程函数返回，相应的线
         }   // 取完任务就释放锁了，执行任务的时候不应该拿着锁占时间
 
         // 当前线程负责执行这个任务
-        if(task != nullptr) {
+        if(task) {
             //  task->run();
             // 执行完一个任务, 把任务的返回值 setVal 方法给到 Result
-            // 封装一个方法
-            task->exec();
+            // 封装一个方法 Task 任务被包装成 [sp]() { sp->exec(); }
+            task();
         }
         // 执行完任务空闲了
         idleThreadSize_++;
@@ -235,7 +254,7 @@ int Thread::generateId_ = 0;
 
 /// 线程构造
 Thread::Thread(ThreadFunc func)
-    : func_(func)
+    : func_(std::move(func))
     , threadId_(generateId_++)
 {}
 
@@ -245,7 +264,8 @@ Thread::~Thread() {}
 /// 启动线程
 void Thread::start() {
     // 创建一个线程来执行一个线程函数
-    std::thread t(func_,threadId_);   //C++11 线程对象t 和线程函数func_
+    // func_ 只能移动，每个 Thread 对象只启动一次
+    std::thread t(std::move(func_),threadId_);   //C++11 线程对象t 和线程函数func_
 
     //分离线程对象和执行的线程函数
     t.detach(); // 设置分离线程 = pthread_detach 防止孤儿线程
@@ -282,18 +302,206 @@ void Result::setVal(Any any) {
 }
 
 
+//////////////////////// CompletionQueue 方法实现
+
+CompletionQueue::CompletionQueue()
+    : head_(nullptr)
+    , waiters_(0)
+    , pushers_(0)
+{}
+
+CompletionQueue::~CompletionQueue() {
+    // 结果被取走之后 worker 可能还在 push 里通知条件变量，等它们全部离开再析构成员
+    while(pushers_.load() != 0) {
+        std::this_thread::yield();
+    }
+
+    // 释放还没被取走的完成结果
+    Node* node = head_.exchange(nullptr);
+    while(node != nullptr) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+/// worker 线程调用
+void CompletionQueue::push(std::shared_ptr<Task> task, Any value) {
+    Node* node = new Node{Completion{std::move(task), std::move(value)}, nullptr};
+
+    // 必须在结果对消费者可见之前登记，消费者取走结果后可能马上析构队列
+    pushers_++;
+
+    // CAS 压到无锁栈的栈顶，不和其他 worker 以及消费者抢锁
+    // 用局部变量记住 CAS 成功时的旧栈顶，节点发布之后消费者会改写 node->next，不能再读
+    Node* oldHead = head_.load(std::memory_order_relaxed);
+    do {
+        node->next = oldHead;
+    } while(!head_.compare_exchange_weak(oldHead, node));
+
+    // 只有把栈从空变成非空的 worker 才需要通知：
+    // 栈原来不空的话，之前的 worker 已经通知过，或者等待者检查条件时能直接看到这些结果
+    // 压栈和读 waiters_ 都是 seq_cst：
+    // 要么这里看到了等待者去通知，要么等待者在 wait 之前检查条件时能看到这个结果
+    // 一个结果只能满足一个等待者，剩下的由取到结果的消费者接力通知 (wakeNext)
+    if(oldHead == nullptr && waiters_.load() > 0) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        cond_.notify_one();
+    }
+
+    // 对 *this 的最后一次访问，之后队列随时可能被析构
+    pushers_--;
+}
+
+/// 把无锁栈整体摘下来，反转成完成顺序追加到 ready_
+void CompletionQueue::collect() {
+    Node* node = head_.exchange(nullptr);
+
+    Node* reversed = nullptr;
+    while(node != nullptr) {
+        Node* next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+
+    while(reversed != nullptr) {
+        Node* next = reversed->next;
+        ready_.push(std::move(reversed->completion));
+        delete reversed;
+        reversed = next;
+    }
+}
+
+/// timeout 为空表示一直等待
+bool CompletionQueue::waitReady(std::unique_lock<std::mutex>& lock, const std::chrono::milliseconds* timeout) {
+    collect();
+    if(!ready_.empty()) {
+        return true;
+    }
+
+    auto ready = [&]()->bool {
+        collect();
+        return !ready_.empty();
+    };
+
+    waiters_++;
+    bool ok = true;
+    if(timeout == nullptr) {
+        cond_.wait(lock, ready);
+    } else {
+        ok = cond_.wait_for(lock, *timeout, ready);
+    }
+    waiters_--;
+    return ok;
+}
+
+/// 持有 mtx_ 时调用，取完之后还有结果就接力唤醒下一个等待者
+void CompletionQueue::wakeNext() {
+    if((!ready_.empty() || head_.load() != nullptr) && waiters_.load() > 0) {
+        cond_.notify_one();
+    }
+}
+
+size_t CompletionQueue::takeReady(std::vector<Completion>& out, size_t maxCount) {
+    size_t count = 0;
+    while(count < maxCount && !ready_.empty()) {
+        out.push_back(std::move(ready_.front()));
+        ready_.pop();
+        ++count;
+    }
+    return count;
+}
+
+CompletionQueue::Completion CompletionQueue::pop() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    waitReady(lock, nullptr);
+    Completion completion = std::move(ready_.front());
+    ready_.pop();
+    wakeNext();
+    return completion;
+}
+
+bool CompletionQueue::popFor(Completion& out, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if(!waitReady(lock, &timeout)) {
+        return false;
+    }
+    out = std::move(ready_.front());
+    ready_.pop();
+    wakeNext();
+    return true;
+}
+
+bool CompletionQueue::tryPop(Completion& out) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    collect();
+    if(ready_.empty()) {
+        return false;
+    }
+    out = std::move(ready_.front());
+    ready_.pop();
+    wakeNext();
+    return true;
+}
+
+size_t CompletionQueue::popBatch(std::vector<Completion>& out, size_t maxCount) {
+    if(maxCount == 0) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    waitReady(lock, nullptr);
+    size_t count = takeReady(out, maxCount);
+    wakeNext();
+    return count;
+}
+
+size_t CompletionQueue::popBatchFor(std::vector<Completion>& out, size_t maxCount, std::chrono::milliseconds timeout) {
+    if(maxCount == 0) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    if(!waitReady(lock, &timeout)) {
+        return 0;
+    }
+    size_t count = takeReady(out, maxCount);
+    wakeNext();
+    return count;
+}
+
+size_t CompletionQueue::tryPopBatch(std::vector<Completion>& out, size_t maxCount) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    collect();
+    size_t count = takeReady(out, maxCount);
+    wakeNext();
+    return count;
+}
+
+
 //////////////////////// Task 方法实现
 
 Task::Task()
     : result_(nullptr)
+    , completionQueue_(nullptr)
 {}
 
 void Task::exec() {
     if(result_ != nullptr) {
         result_->setVal(run()); // 这里发生多态调用
+    } else if(completionQueue_ != nullptr) {
+        Any value = run();
+        completionQueue_->push(shared_from_this(), std::move(value));
     }
 }
 
+/// 每次提交只有一个接收结果的地方，清掉上一次提交留下的完成队列
 void Task::setResult(Result* res) {
     result_ = res;
+    completionQueue_ = nullptr;
+}
+
+/// 每次提交只有一个接收结果的地方，清掉上一次提交留下的 Result
+void Task::setCompletionQueue(CompletionQueue* cq) {
+    completionQueue_ = cq;
+    result_ = nullptr;
 }
\ No newline at end of file
@@ -9,6 +9,12 @@
 #include <condition_variable>
 #include <functional>
 #include <thread>
+#include <chrono>
+#include <future>
+#include <tuple>
+#include <type_traits>
+#include <new>
+#include <cstddef>
 
 
 /**
@@ -66,6 +72,158 @@ private:
 };
 
 
+/**
+ * @brief Function 类型：只能移动的类型擦除可调用对象，带内联缓冲区
+ * @note
+ *      std::function 要求可拷贝，装不下捕获了 std::promise / unique_ptr 的 lambda
+ *      这里和 Any 一样做类型擦除，但不用 虚函数 + 堆对象：
+ *
+ *      Function =》 ops_ ----> { invoke, move, destroy }   每种可调用类型一份静态函数表
+ *                   buffer_ -> 可调用对象本身（不超过 BufferSize 且移动不抛异常）
+ *                           -> 或者指向堆上可调用对象的指针（放不下的时候）
+ *
+ *      常见的小捕获 lambda 直接放在 buffer_ 里，不会有堆分配
+ */
+template<typename Signature>
+class Function;
+
+template<typename R, typename... Args>
+class Function<R(Args...)> {
+public:
+    /// 内联缓冲区大小
+    static constexpr std::size_t BufferSize = 64;
+
+    Function() noexcept
+        : ops_(nullptr)
+    {}
+
+    Function(std::nullptr_t) noexcept
+        : ops_(nullptr)
+    {}
+
+    /// 这个构造函数可以接收任意可调用对象，包括只能移动的
+    /// 要求能用 Args... 调用并且返回值能转换成 R，否则在调用处就报错
+    template<typename F,
+             typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Function>
+                                         && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>>
+    Function(F&& func)
+        : ops_(&Manager<std::decay_t<F>>::ops)
+    {
+        using Fn = std::decay_t<F>;
+        if constexpr (isInline<Fn>) {
+            ::new (static_cast<void*>(buffer_)) Fn(std::forward<F>(func));
+        } else {
+            ::new (static_cast<void*>(buffer_)) Fn*(new Fn(std::forward<F>(func)));
+        }
+    }
+
+    ~Function() {
+        reset();
+    }
+
+    Function(const Function&) = delete;
+    Function& operator=(const Function&) = delete;
+
+    Function(Function&& other) noexcept
+        : ops_(other.ops_)
+    {
+        if(ops_ != nullptr) {
+            ops_->move(buffer_, other.buffer_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Function& operator=(Function&& other) noexcept {
+        if(this != &other) {
+            reset();
+            ops_ = other.ops_;
+            if(ops_ != nullptr) {
+                ops_->move(buffer_, other.buffer_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    /// 调用保存的可调用对象，和 std::function 一样空对象抛出 std::bad_function_call
+    R operator()(Args... args) {
+        if(ops_ == nullptr) {
+            throw std::bad_function_call();
+        }
+        return ops_->invoke(buffer_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept {
+        return ops_ != nullptr;
+    }
+
+private:
+    /// 每种可调用类型对应的操作表
+    struct Ops {
+        R (*invoke)(void* storage, Args&&... args);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    /// 能不能直接放进内联缓冲区，移动可能抛异常的放到堆上，保证 Function 的移动不抛异常
+    template<typename Fn>
+    static constexpr bool isInline = sizeof(Fn) <= BufferSize
+        && alignof(Fn) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible_v<Fn>;
+
+    template<typename Fn>
+    struct Manager {
+        static Fn* get(void* storage) noexcept {
+            if constexpr (isInline<Fn>) {
+                return std::launder(reinterpret_cast<Fn*>(storage));
+            } else {
+                return *std::launder(reinterpret_cast<Fn**>(storage));
+            }
+        }
+
+        static R invoke(void* storage, Args&&... args) {
+            // R 是 void 时和 std::function 一样丢弃返回值
+            if constexpr (std::is_void_v<R>) {
+                std::invoke(*get(storage), std::forward<Args>(args)...);
+            } else {
+                return std::invoke(*get(storage), std::forward<Args>(args)...);
+            }
+        }
+
+        static void move(void* dst, void* src) noexcept {
+            if constexpr (isInline<Fn>) {
+                ::new (dst) Fn(std::move(*get(src)));
+                get(src)->~Fn();
+            } else {
+                // 堆上的对象只需要转移指针
+                ::new (dst) Fn*(get(src));
+            }
+        }
+
+        static void destroy(void* storage) noexcept {
+            if constexpr (isInline<Fn>) {
+                get(storage)->~Fn();
+            } else {
+                delete get(storage);
+            }
+        }
+
+        static constexpr Ops ops{&Manager::invoke, &Manager::move, &Manager::destroy};
+    };
+
+    void reset() noexcept {
+        if(ops_ != nullptr) {
+            ops_->destroy(buffer_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    const Ops* ops_;
+    alignas(std::max_align_t) unsigned char buffer_[BufferSize];
+};
+
+
 /**
  * @brief 实现一个信号量用于通信
  * @note
@@ -134,22 +292,101 @@ private:
     std::atomic_bool isValid_;
 };
 
+/**
+ * @brief 完成队列：按任务执行完成的先后顺序取结果
+ * @note
+ *      Result::get() 需要用户自己挑一个任务去等，慢任务会挡住已经完成的任务
+ *      提交时把任务绑定到 CompletionQueue 上，任务执行完由 worker 线程无锁地压入完成结果
+ *      用户按完成顺序一个一个或者一批一批地取结果
+ *
+ *      worker 线程 --CAS push--> head_(无锁栈) --整体摘下并反转--> ready_ --> 用户线程
+ *
+ *      只有把栈从空变成非空、并且存在阻塞等待的消费者时，worker 才会去拿锁通知条件变量
+ *
+ *      生命周期：绑定到队列上的任务执行完之前，队列不能析构
+ *      结果被取走时 worker 可能还没从 push 返回，析构函数会等正在 push 的 worker 全部离开
+ */
+class CompletionQueue {
+public:
+    /// 一个已完成任务：任务对象 + 它的返回值
+    struct Completion {
+        std::shared_ptr<Task> task;
+        Any value;
+    };
+
+    CompletionQueue();
+    ~CompletionQueue();
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+    /// 阻塞直到有一个任务完成
+    Completion pop();
+    /// 最多等待 timeout，超时返回 false
+    bool popFor(Completion& out, std::chrono::milliseconds timeout);
+    /// 不阻塞，没有已完成的任务返回 false
+    bool tryPop(Completion& out);
+
+    /// 阻塞直到至少有一个任务完成，最多取 maxCount 个追加到 out，返回取到的个数
+    size_t popBatch(std::vector<Completion>& out, size_t maxCount);
+    /// 最多等待 timeout，超时返回 0
+    size_t popBatchFor(std::vector<Completion>& out, size_t maxCount, std::chrono::milliseconds timeout);
+    /// 不阻塞，取走当前已完成的最多 maxCount 个
+    size_t tryPopBatch(std::vector<Completion>& out, size_t maxCount);
+
+private:
+    friend class Task;
+
+    struct Node {
+        Completion completion;
+        Node* next;
+    };
+
+    /// worker 线程调用，无锁压入一个完成结果
+    void push(std::shared_ptr<Task> task, Any value);
+    /// 持有 mtx_ 时调用，把无锁栈里的结果按完成顺序搬到 ready_
+    void collect();
+    /// 持有 mtx_ 时调用，等待直到 ready_ 不空或者超时
+    bool waitReady(std::unique_lock<std::mutex>& lock, const std::chrono::milliseconds* timeout);
+    /// 持有 mtx_ 时调用，还有剩余结果时唤醒下一个等待者
+    void wakeNext();
+    /// 持有 mtx_ 时调用，从 ready_ 取最多 maxCount 个
+    size_t takeReady(std::vector<Completion>& out, size_t maxCount);
+
+private:
+    /// worker 线程压入的无锁栈，栈顶是最后完成的任务
+    std::atomic<Node*> head_;
+    /// 消费者一侧按完成顺序排好的结果
+    std::queue<Completion> ready_;
+    /// 正在阻塞等待的消费者数量，为 0 时 worker 不需要拿锁通知
+    std::atomic_int waiters_;
+    /// 正在 push 里的 worker 数量，析构时等它归零
+    std::atomic_int pushers_;
+
+    /// 保护 ready_ 以及消费者之间的互斥
+    std::mutex mtx_;
+    /// 有新的完成结果
+    std::condition_variable cond_;
+};
+
 /**
  * @brief 任务抽象基类
  * 
  */
-class Task {
+class Task : public std::enable_shared_from_this<Task> {
 public:
     Task();
     ~Task() = default;
     void exec();
     void setResult(Result* res);
+    void setCompletionQueue(CompletionQueue* cq);
 
     ///用户可以自定义任务数据类型，从 Task 继承重写 run 方法，实现自定义任务处理
 	virtual Any run() = 0;
 private:
     /// 如果强智能指针的话就循环引用了, Result 对象生命周期长于 Task
     Result* result_;
+    /// 绑定的完成队列，和 result_ 同时只有一个有效，队列必须等任务执行完才能析构
+    CompletionQueue* completionQueue_;
 };
 
 
@@ -172,7 +409,7 @@ enum class PoolMode {
 class Thread {
 public:
     /// 线程函数对象类型
-    using ThreadFunc = std::function<void(int)>;
+    using ThreadFunc = Function<void(int)>;
     /// 线程构造
     Thread(ThreadFunc func);
     /// 线程析构
@@ -202,9 +439,17 @@ private:
  *
  * pool.sumbitTask(std::make_shared<MyTask>());
  *
+ * // 不需要继承 Task，直接提交 lambda / 函数对象
+ * std::future<int> res = pool.submit([](int a, int b) { return a + b; }, 1, 2);
+ * // 不需要返回值
+ * pool.execute([](int a) { ... }, 1);
+ *
  */
 class ThreadPool {
 public:
+    /// 任务队列里存放的任务类型
+    using TaskFunc = Function<void()>;
+
 	/// 线程池构造
 	ThreadPool();
 
@@ -229,6 +474,57 @@ public:
 	/// 给线程池提交任务
 	Result submitTask(std::shared_ptr<Task> sp);
 
+	/// 给线程池提交任务，执行完的结果压入 cq，提交失败返回 false
+	bool submitTask(std::shared_ptr<Task> sp, CompletionQueue& cq);
+
+	/// 给线程池提交任意可调用对象，通过返回的 future 获取返回值
+	/// 提交失败时 future.get() 抛出 std::future_error(broken_promise)
+	/// 可调用对象放在 TaskFunc 内联缓冲区里不分配，但 std::promise 每个任务要堆分配
+	/// (libstdc++ 下 2 次：共享状态 + 结果存储)，不需要返回值时用 execute
+	template<typename Func, typename... Args>
+	auto submit(Func&& func, Args&&... args)
+	    -> std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>> {
+	    using RType = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+	    std::promise<RType> promise;
+	    std::future<RType> result = promise.get_future();
+
+	    // promise、可调用对象和参数都移动进 lambda，小捕获直接放在 TaskFunc 的内联缓冲区
+	    // 这里只有 promise 的分配，lambda 本身不分配
+	    TaskFunc task([promise = std::move(promise),
+	                   func = std::forward<Func>(func),
+	                   args = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable {
+	        try {
+	            if constexpr (std::is_void_v<RType>) {
+	                std::apply(std::move(func), std::move(args));
+	                promise.set_value();
+	            } else {
+	                promise.set_value(std::apply(std::move(func), std::move(args)));
+	            }
+	        } catch(...) {
+	            promise.set_exception(std::current_exception());
+	        }
+	    });
+
+	    std::unique_lock<std::mutex> lock(taskQueMtx_);
+	    // 提交失败 task 析构，promise 随之析构，future 得到 broken_promise
+	    enqueueTask(lock, std::move(task));
+	    return result;
+	}
+
+	/// 给线程池提交任意可调用对象，不关心返回值，提交失败返回 false
+	/// 没有 promise，捕获不超过 TaskFunc::BufferSize 时每个任务没有堆分配
+	/// 和 Task::run 一样，可调用对象抛出的异常不会被捕获
+	template<typename Func, typename... Args>
+	bool execute(Func&& func, Args&&... args) {
+	    TaskFunc task([func = std::forward<Func>(func),
+	                   args = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable {
+	        std::apply(std::move(func), std::move(args));
+	    });
+
+	    std::unique_lock<std::mutex> lock(taskQueMtx_);
+	    return enqueueTask(lock, std::move(task));
+	}
+
 
 	/// 禁止拷贝构造和赋值
 	ThreadPool(const ThreadPool&) = delete;
@@ -237,6 +533,8 @@ public:
 private:
     /// 定义线程函数
     void threadFunc(int threadid);
+    /// 持有 taskQueMtx_ 时调用，把任务放入任务队列，队列满超时返回 false
+    bool enqueueTask(std::unique_lock<std::mutex>& lock, TaskFunc&& task);
     /// 检查 pool 运行状态
     bool checkRunningState() const;
 private:
@@ -261,8 +559,8 @@ private:
 	// 出了提交任务的语句对象就析构了，拿了已经析构的对象就没用了
 	// 使用智能指针保持拉长对象声明周期，自动释放资源
 	
-	/// 任务队列
-	std::queue<std::shared_ptr<Task> > taskQue_;
+	/// 任务队列 可调用对象直接存放在队列的槽位里
+	std::queue<TaskFunc> taskQue_;
 		
 	/// 任务数量 被多线程加减，原子类型
 	std::atomic_uint taskSize_; 